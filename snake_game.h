@@ -0,0 +1,369 @@
+#ifndef __SNAKE_GAME_H__
+#define __SNAKE_GAME_H__
+
+/*
+ * Game state and rules shared by the kernel driver (ssd1306.c) and the
+ * userspace daemon (snake_user.c). Nothing in here talks to the panel,
+ * callers render into a frame buffer and send it with their own transport.
+ */
+#ifdef __KERNEL__
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/random.h>
+#include <linux/string.h>
+#define snake_calloc(n, size) kvcalloc(n, size, GFP_KERNEL)
+#define snake_free(ptr) kvfree(ptr)
+#define snake_random() get_random_u32()
+#define snake_warn_on(cond) WARN_ON_ONCE(cond)
+#else
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#define snake_calloc(n, size) calloc(n, size)
+#define snake_free(ptr) free(ptr)
+#define snake_random() ((uint32_t)rand())
+#define snake_warn_on(cond)                                                  \
+	do                                                                       \
+	{                                                                        \
+		if (cond)                                                            \
+			fprintf(stderr, "snake: %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+	} while (0)
+#endif
+#include "ssd1306.h"
+
+/* Screen: one score row, then VIEW_ROWS rows of VIEW_COLS cells */
+#define VIEW_COLS (OLED_WIDTH / FONT_X)
+#define VIEW_ROWS (OLED_HEIGHT / 8 - 1)
+#define SNAKE_LINE_SIZE (VIEW_COLS * FONT_X)
+#define SNAKE_FRAME_SIZE (SNAKE_LINE_SIZE * (VIEW_ROWS + 1))
+
+/* Cells kept between the head and the viewport edge before it scrolls */
+#define VIEW_MARGIN_X 5
+#define VIEW_MARGIN_Y 2
+
+#define WORLD_MAX 256
+#define SNAKE_MAX_LENGTH 0xFFFF
+#define SNAKE_INPUT_DEPTH 4
+
+struct snake_game
+{
+	uint16_t world_width;
+	uint16_t world_height;
+	uint8_t *occupied; /* one bit per world cell covered by the snake */
+
+	bool gameover;
+	control_t button;
+	control_t heading; /* direction of the last move */
+	control_t input[SNAKE_INPUT_DEPTH]; /* presses waiting for a tick, oldest first */
+	uint8_t input_count;
+	uint32_t score;
+	struct snake *mySnake; /* ring of max_length segments, allocated once */
+	struct food myFood;
+	uint16_t current_length;
+	uint16_t max_length;
+	uint16_t head_index; /* slot of the head in mySnake, the body follows at increasing slots */
+
+	/* Viewport: world cell shown at the top left of the play area */
+	uint8_t view_X;
+	uint8_t view_Y;
+};
+
+static inline bool world_contains(const struct snake_game *game, uint8_t x, uint8_t y)
+{
+	return x < game->world_width && y < game->world_height;
+}
+/* Bit index in game->occupied, callers check world_contains() first */
+static inline unsigned long world_cell(const struct snake_game *game, uint8_t x, uint8_t y)
+{
+	snake_warn_on(!world_contains(game, x, y));
+	return (unsigned long)y * game->world_width + x;
+}
+static inline bool world_test(const struct snake_game *game, uint8_t x, uint8_t y)
+{
+	unsigned long cell = world_cell(game, x, y);
+	return game->occupied[cell / 8] & (1 << (cell % 8));
+}
+static inline void world_set(struct snake_game *game, uint8_t x, uint8_t y)
+{
+	unsigned long cell = world_cell(game, x, y);
+	game->occupied[cell / 8] |= 1 << (cell % 8);
+}
+static inline void world_clear(struct snake_game *game, uint8_t x, uint8_t y)
+{
+	unsigned long cell = world_cell(game, x, y);
+	game->occupied[cell / 8] &= ~(1 << (cell % 8));
+}
+
+/* Segment i of the body, 0 is the head */
+static inline struct snake *snake_segment(const struct snake_game *game, uint16_t i)
+{
+	return &game->mySnake[(game->head_index + i) % game->max_length];
+}
+
+/*
+ * Food goes on a free interior cell, scanning on from a random one. With no
+ * free cell left it is parked on the border at (0, 0), out of the snake's reach.
+ */
+static inline void snake_new_food(struct snake_game *game)
+{
+	uint32_t inner_width = game->world_width - 2;
+	uint32_t cells = inner_width * (game->world_height - 2);
+	uint32_t start = snake_random() % cells, i, cell;
+	for (i = 0; i < cells; i++)
+	{
+		cell = (start + i) % cells;
+		game->myFood.x = 1 + cell % inner_width;
+		game->myFood.y = 1 + cell / inner_width;
+		if (!world_test(game, game->myFood.x, game->myFood.y))
+			return;
+	}
+	game->myFood.x = 0;
+	game->myFood.y = 0;
+}
+static inline void snake_game_setup(struct snake_game *game)
+{
+	struct snake *head = snake_segment(game, 0);
+	game->button = PAUSE;
+	game->heading = PAUSE;
+	game->input_count = 0;
+	game->gameover = false;
+	head->x = game->world_width / 2;
+	head->y = game->world_height / 2;
+	world_set(game, head->x, head->y);
+	game->view_X = head->x - VIEW_COLS / 2 < 0 ? 0 : head->x - VIEW_COLS / 2;
+	game->view_Y = head->y - VIEW_ROWS / 2 < 0 ? 0 : head->y - VIEW_ROWS / 2;
+	if (game->view_X > game->world_width - VIEW_COLS)
+		game->view_X = game->world_width - VIEW_COLS;
+	if (game->view_Y > game->world_height - VIEW_ROWS)
+		game->view_Y = game->world_height - VIEW_ROWS;
+	snake_new_food(game);
+}
+/*
+ * The world is clamped to VIEW_COLS x VIEW_ROWS .. WORLD_MAX x WORLD_MAX. The
+ * body ring is sized for the longest possible snake up front (512 KiB at
+ * 256 x 256), so growing never allocates.
+ */
+static inline int snake_game_init(struct snake_game *game, unsigned int width, unsigned int height)
+{
+	uint32_t cells;
+	memset(game, 0, sizeof(*game));
+	game->world_width = width < VIEW_COLS ? VIEW_COLS : width > WORLD_MAX ? WORLD_MAX : width;
+	game->world_height = height < VIEW_ROWS ? VIEW_ROWS : height > WORLD_MAX ? WORLD_MAX : height;
+	cells = (uint32_t)game->world_width * game->world_height;
+	game->occupied = snake_calloc((cells + 7) / 8, 1);
+	if (!game->occupied)
+		return -1;
+	game->max_length = cells < SNAKE_MAX_LENGTH ? cells : SNAKE_MAX_LENGTH;
+	game->current_length = 1;
+	game->mySnake = snake_calloc(game->max_length, sizeof(struct snake));
+	if (!game->mySnake)
+	{
+		snake_free(game->occupied);
+		return -1;
+	}
+	snake_game_setup(game);
+	return 0;
+}
+static inline void snake_game_free(struct snake_game *game)
+{
+	snake_free(game->mySnake);
+	snake_free(game->occupied);
+}
+/*
+ * Button press: queued and taken one per tick, so two quick turns between
+ * ticks both happen. A press that repeats the direction it follows or turns
+ * the snake back onto itself is dropped, as is one that finds the queue full.
+ */
+static inline void snake_game_input(struct snake_game *game, control_t button)
+{
+	control_t last = game->input_count ? game->input[game->input_count - 1] : game->heading;
+	if (game->input_count == SNAKE_INPUT_DEPTH || button == last)
+		return;
+	if ((button == UP && last != DOWN) ||
+		(button == DOWN && last != UP) ||
+		(button == LEFT && last != RIGHT) ||
+		(button == RIGHT && last != LEFT))
+		game->input[game->input_count++] = button;
+}
+static inline void move(struct snake *snk)
+{
+	switch (snk->direction)
+	{
+	case UP:
+		snk->y--;
+		break;
+	case DOWN:
+		snk->y++;
+		break;
+	case LEFT:
+		snk->x--;
+		break;
+	case RIGHT:
+		snk->x++;
+		break;
+	default:
+		break;
+	}
+}
+/* Grows by one segment: the copy of the tail stays put while the body moves up */
+static inline int add_new_element(struct snake_game *game)
+{
+	if (game->current_length >= game->max_length)
+		return -1;
+	*snake_segment(game, game->current_length) = *snake_segment(game, game->current_length - 1);
+	game->current_length += 1;
+	return 0;
+}
+static inline void snake_game_logic(struct snake_game *game)
+{
+	struct snake head = *snake_segment(game, 0);
+	struct snake *tail;
+	bool ate, grow;
+	if (game->input_count)
+	{
+		game->button = game->input[0];
+		game->input_count--;
+		memmove(&game->input[0], &game->input[1], game->input_count * sizeof(control_t));
+	}
+	if (game->button == PAUSE)
+		return;
+	head.direction = game->button;
+	move(&head);
+	game->heading = head.direction;
+	ate = head.x == game->myFood.x && head.y == game->myFood.y;
+	grow = ate && add_new_element(game) == 0;
+	/*
+	 * Every segment takes the place of the one ahead of it: the head moves
+	 * one slot back in the ring, over the old tail once the ring is full.
+	 * The tail cell frees up unless growing.
+	 */
+	tail = snake_segment(game, game->current_length - 1);
+	if (!grow && world_contains(game, tail->x, tail->y))
+		world_clear(game, tail->x, tail->y);
+	game->head_index = (game->head_index + game->max_length - 1) % game->max_length;
+	*snake_segment(game, 0) = head;
+	if (!world_contains(game, head.x, head.y) || head.x == 0 || head.x == game->world_width - 1 || head.y == 0 || head.y == game->world_height - 1) // wall collision
+		game->gameover = true;
+	else if (world_test(game, head.x, head.y)) // collision check
+		game->gameover = true;
+	if (world_contains(game, head.x, head.y))
+		world_set(game, head.x, head.y);
+	if (ate) // ate food
+	{
+		snake_new_food(game);
+		game->score += 10;
+	}
+}
+/*
+ * Keep the head at least VIEW_MARGIN cells inside the viewport. Returns how
+ * many rows the view moved down, the driver rotates the start line by it.
+ */
+static inline int snake_update_viewport(struct snake_game *game)
+{
+	int x = game->view_X;
+	int y = game->view_Y;
+	int head_x = snake_segment(game, 0)->x;
+	int head_y = snake_segment(game, 0)->y;
+	int dy;
+	if (head_x < x + VIEW_MARGIN_X)
+		x = head_x - VIEW_MARGIN_X;
+	else if (head_x >= x + VIEW_COLS - VIEW_MARGIN_X)
+		x = head_x - VIEW_COLS + VIEW_MARGIN_X + 1;
+	if (head_y < y + VIEW_MARGIN_Y)
+		y = head_y - VIEW_MARGIN_Y;
+	else if (head_y >= y + VIEW_ROWS - VIEW_MARGIN_Y)
+		y = head_y - VIEW_ROWS + VIEW_MARGIN_Y + 1;
+	if (x > game->world_width - VIEW_COLS)
+		x = game->world_width - VIEW_COLS;
+	if (x < 0)
+		x = 0;
+	if (y > game->world_height - VIEW_ROWS)
+		y = game->world_height - VIEW_ROWS;
+	if (y < 0)
+		y = 0;
+	dy = y - game->view_Y;
+	game->view_X = x;
+	game->view_Y = y;
+	return dy;
+}
+static inline int embedded_to_buffer(uint8_t *frame_buffer, const char *data, int start, int length)
+{
+	int index = FONT_X * start;
+	if (start < 0 || index + FONT_X * length > SNAKE_FRAME_SIZE)
+		return -1;
+	for (int i = 0; i < length; i++)
+	{
+		memcpy(&frame_buffer[index], ssd1306_font[*data++ - 32], FONT_X);
+		index += FONT_X;
+	}
+	return 0;
+}
+/*
+ * Score row, then the VIEW_ROWS x VIEW_COLS cells of the viewport. Food out of
+ * view is pointed at from the right end of the score row, e.g. "*^>".
+ */
+static inline void snake_game_render(const struct snake_game *game, uint8_t *frame_buffer)
+{
+	const struct snake *head = snake_segment(game, 0);
+	char scoreBuffer[VIEW_COLS + 1];
+	char hint[4] = "*  ";
+	int i, j, index = SNAKE_LINE_SIZE;
+	uint8_t x, y;
+	char glyph;
+	for (i = 0; i < VIEW_ROWS; i++)
+	{
+		y = game->view_Y + i;
+		for (j = 0; j < VIEW_COLS; j++)
+		{
+			x = game->view_X + j;
+			if (y == 0 || y == game->world_height - 1 || x == 0 || x == game->world_width - 1)
+				glyph = '+';
+			else if (y == head->y && x == head->x)
+			{
+				switch (head->direction)
+				{
+				case UP:
+					glyph = '^';
+					break;
+				case DOWN:
+					glyph = 'v';
+					break;
+				case LEFT:
+					glyph = '<';
+					break;
+				case RIGHT:
+					glyph = '>';
+					break;
+				default:
+					glyph = '?';
+					break;
+				}
+			}
+			else if (y == game->myFood.y && x == game->myFood.x)
+				glyph = '*';
+			else if (world_test(game, x, y))
+				glyph = 'o';
+			else
+				glyph = ' ';
+			memcpy(&frame_buffer[index], ssd1306_font[glyph - 32], FONT_X);
+			index += FONT_X;
+		}
+	}
+	memset(frame_buffer, 0, SNAKE_LINE_SIZE);
+	snprintf(scoreBuffer, sizeof(scoreBuffer), "Score: %u", game->score);
+	embedded_to_buffer(frame_buffer, scoreBuffer, 0, strlen(scoreBuffer));
+	if (game->myFood.y < game->view_Y)
+		hint[1] = '^';
+	else if (game->myFood.y >= game->view_Y + VIEW_ROWS)
+		hint[1] = 'v';
+	if (game->myFood.x < game->view_X)
+		hint[2] = '<';
+	else if (game->myFood.x >= game->view_X + VIEW_COLS)
+		hint[2] = '>';
+	if (hint[1] != ' ' || hint[2] != ' ')
+		embedded_to_buffer(frame_buffer, hint, VIEW_COLS - 3, 3);
+}
+
+#endif /* __SNAKE_GAME_H__ */
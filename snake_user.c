@@ -0,0 +1,453 @@
+/*
+ * Userspace variant of the Snake game for boards that cannot load the
+ * kernel module. Drives the same ssd1306 panel through /dev/i2c-N and
+ * reads the buttons from the GPIO character device.
+ */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include <linux/gpio.h>
+#include "ssd1306.h"
+#include "snake_game.h"
+
+#define BUTTON_UP 1
+#define BUTTON_DOWN 0
+#define BUTTON_LEFT 3
+#define BUTTON_RIGHT 2
+
+#define max_X VIEW_COLS
+#define max_Y (VIEW_ROWS + 1)
+#define LINE_SIZE SNAKE_LINE_SIZE
+#define frame_size SNAKE_FRAME_SIZE
+
+#define DEBOUNCE_NS 20000000ULL
+
+struct ssd1306
+{
+	int i2c_fd;
+	uint16_t addr;
+	bool rdwr; /* adapter supports plain I2C, else fall back to SMBus blocks */
+	int line_fd;
+	unsigned int lines[4];
+	uint64_t last_event[4];
+
+	uint8_t frame_buffer[frame_size];
+	uint8_t panel_buffer[frame_size]; /* what the panel GDDRAM holds */
+
+	/* Game Area */
+	struct snake_game game;
+};
+
+/* One batch of messages, sent with a single I2C_RDWR ioctl */
+struct i2c_batch
+{
+	struct i2c_msg msgs[2 * max_Y];
+	uint8_t cmd[max_Y][7];
+	uint8_t data[max_Y][LINE_SIZE + 1];
+	int count;
+};
+
+static int ssd1306_transfer(struct ssd1306 *oled, struct i2c_msg *msgs, int count);
+static int ssd1306_burst_write(struct ssd1306 *oled, const uint8_t *data, int len, write_mode_t mode);
+static int ssd1306_init(struct ssd1306 *oled);
+static int ssd1306_clear(struct ssd1306 *oled);
+static int ssd1306_sync(struct ssd1306 *oled);
+static int button_open(struct ssd1306 *oled, const char *chip);
+static void button_read(struct ssd1306 *oled);
+
+/* Snake Game Area */
+static void snake_game_draw(struct ssd1306 *oled);
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+			"Usage: %s [-b bus] [-a addr] [-c gpiochip] [-g down,up,right,left] [-s speed] [-W width] [-H height]\n"
+			"  -b  i2c bus number (default 5, /dev/i2c-5)\n"
+			"  -a  panel address (default 0x3c)\n"
+			"  -c  gpio chip (default /dev/gpiochip0)\n"
+			"  -g  button line offsets in devicetree order (default 23,24,25,26)\n"
+			"  -s  speed of snake in ticks per second (default 4)\n"
+			"  -W  width of the game world in cells, 21 - 256 (default 21)\n"
+			"  -H  height of the game world in cells, 7 - 256 (default 7)\n",
+			prog);
+}
+
+int main(int argc, char **argv)
+{
+	static struct ssd1306 oled_data;
+	struct ssd1306 *oled = &oled_data;
+	struct epoll_event ev, events[3];
+	struct itimerspec period;
+	struct timespec now;
+	struct signalfd_siginfo sig;
+	unsigned long funcs;
+	uint64_t expired, ticks = 0;
+	const char *chip = "/dev/gpiochip0";
+	char i2c_dev[32];
+	unsigned int speed = 4;
+	unsigned int world_width = VIEW_COLS;
+	unsigned int world_height = VIEW_ROWS;
+	int bus = 5;
+	int opt, i, n, epfd, tfd, sfd;
+	bool running = true;
+	sigset_t mask;
+
+	oled->addr = 0x3c;
+	oled->lines[BUTTON_DOWN] = 23;
+	oled->lines[BUTTON_UP] = 24;
+	oled->lines[BUTTON_RIGHT] = 25;
+	oled->lines[BUTTON_LEFT] = 26;
+	while ((opt = getopt(argc, argv, "b:a:c:g:s:W:H:h")) != -1)
+	{
+		switch (opt)
+		{
+		case 'b':
+			bus = atoi(optarg);
+			break;
+		case 'a':
+			oled->addr = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			chip = optarg;
+			break;
+		case 'g':
+			if (sscanf(optarg, "%u,%u,%u,%u", &oled->lines[0], &oled->lines[1], &oled->lines[2], &oled->lines[3]) != 4)
+			{
+				usage(argv[0]);
+				return 1;
+			}
+			break;
+		case 's':
+			speed = strtoul(optarg, NULL, 0);
+			break;
+		case 'W':
+			world_width = strtoul(optarg, NULL, 0);
+			break;
+		case 'H':
+			world_height = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (!speed)
+	{
+		usage(argv[0]);
+		return 1;
+	}
+
+	snprintf(i2c_dev, sizeof(i2c_dev), "/dev/i2c-%d", bus);
+	oled->i2c_fd = open(i2c_dev, O_RDWR | O_CLOEXEC);
+	if (oled->i2c_fd < 0)
+	{
+		perror(i2c_dev);
+		return 1;
+	}
+	if (ioctl(oled->i2c_fd, I2C_FUNCS, &funcs) < 0)
+	{
+		perror("I2C_FUNCS");
+		return 1;
+	}
+	oled->rdwr = funcs & I2C_FUNC_I2C;
+	if (!oled->rdwr && !(funcs & I2C_FUNC_SMBUS_WRITE_I2C_BLOCK))
+	{
+		fprintf(stderr, "%s: adapter supports neither I2C_RDWR nor SMBus block writes\n", i2c_dev);
+		return 1;
+	}
+	if (ioctl(oled->i2c_fd, I2C_SLAVE, oled->addr) < 0)
+	{
+		perror("I2C_SLAVE");
+		return 1;
+	}
+	if (button_open(oled, chip) < 0)
+		return 1;
+	if (ssd1306_init(oled) < 0)
+	{
+		perror("ssd1306 init");
+		return 1;
+	}
+
+	srand(time(NULL));
+	if (snake_game_init(&oled->game, world_width, world_height) < 0)
+	{
+		perror("snake_game_init");
+		return 1;
+	}
+	snake_game_draw(oled);
+
+	/* Ticks come from a periodic timerfd on absolute deadlines, buttons from the line fd */
+	sigemptyset(&mask);
+	sigaddset(&mask, SIGINT);
+	sigaddset(&mask, SIGTERM);
+	sigprocmask(SIG_BLOCK, &mask, NULL);
+	sfd = signalfd(-1, &mask, SFD_CLOEXEC);
+	tfd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (sfd < 0 || tfd < 0 || epfd < 0)
+	{
+		perror("epoll setup");
+		return 1;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	period.it_interval.tv_sec = 1 / speed;
+	period.it_interval.tv_nsec = 1000000000UL / speed % 1000000000UL;
+	period.it_value.tv_sec = now.tv_sec + 1;
+	period.it_value.tv_nsec = now.tv_nsec;
+	if (timerfd_settime(tfd, TFD_TIMER_ABSTIME, &period, NULL) < 0)
+	{
+		perror("timerfd_settime");
+		return 1;
+	}
+	ev.events = EPOLLIN;
+	ev.data.fd = tfd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, tfd, &ev) < 0)
+	{
+		perror("epoll_ctl timerfd");
+		return 1;
+	}
+	ev.data.fd = oled->line_fd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, oled->line_fd, &ev) < 0)
+	{
+		perror("epoll_ctl gpio");
+		return 1;
+	}
+	ev.data.fd = sfd;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, sfd, &ev) < 0)
+	{
+		perror("epoll_ctl signalfd");
+		return 1;
+	}
+	printf("Start game, speed is: %u\n", speed);
+
+	while (running)
+	{
+		n = epoll_wait(epfd, events, 3, -1);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			perror("epoll_wait");
+			break;
+		}
+		for (i = 0; i < n; i++)
+		{
+			if (events[i].data.fd == tfd)
+			{
+				if (read(tfd, &expired, sizeof(expired)) == sizeof(expired))
+					ticks += expired;
+			}
+			else if (events[i].data.fd == oled->line_fd)
+				button_read(oled);
+			else if (read(sfd, &sig, sizeof(sig)) == sizeof(sig))
+				running = false;
+		}
+		if (!ticks || !running)
+			continue;
+		/* Missed ticks are simulated, only the latest state is sent */
+		while (ticks && !oled->game.gameover)
+		{
+			snake_game_logic(&oled->game);
+			ticks--;
+		}
+		ticks = 0;
+		if (!oled->game.gameover)
+			snake_game_draw(oled);
+		else
+		{
+			oled->game.button = PAUSE;
+			embedded_to_buffer(oled->frame_buffer, "Game Over!", 4 * max_X + 5, 10);
+			ssd1306_sync(oled);
+		}
+	}
+
+	ssd1306_clear(oled);
+	ssd1306_burst_write(oled, (const uint8_t[]){0xAE}, 1, COMMAND); // display off
+	snake_game_free(&oled->game);
+	close(epfd);
+	close(tfd);
+	close(sfd);
+	close(oled->line_fd);
+	close(oled->i2c_fd);
+	return 0;
+}
+
+/*
+ * Every msg starts with its control byte. With I2C_RDWR the whole batch is
+ * one ioctl; SMBus-only adapters (e.g. i2c-stub) get 32 byte block writes.
+ */
+static int ssd1306_transfer(struct ssd1306 *oled, struct i2c_msg *msgs, int count)
+{
+	struct i2c_rdwr_ioctl_data rdwr = {
+		.msgs = msgs,
+		.nmsgs = count};
+	struct i2c_smbus_ioctl_data smbus;
+	union i2c_smbus_data block;
+	int i, pos, len;
+	if (oled->rdwr)
+		return ioctl(oled->i2c_fd, I2C_RDWR, &rdwr) < 0 ? -1 : 0;
+	smbus.read_write = I2C_SMBUS_WRITE;
+	smbus.size = I2C_SMBUS_I2C_BLOCK_DATA;
+	smbus.data = &block;
+	for (i = 0; i < count; i++)
+	{
+		smbus.command = msgs[i].buf[0];
+		for (pos = 1; pos < msgs[i].len; pos += len)
+		{
+			len = msgs[i].len - pos;
+			if (len > I2C_SMBUS_BLOCK_MAX)
+				len = I2C_SMBUS_BLOCK_MAX;
+			block.block[0] = len;
+			memcpy(&block.block[1], &msgs[i].buf[pos], len);
+			if (ioctl(oled->i2c_fd, I2C_SMBUS, &smbus) < 0)
+				return -1;
+		}
+	}
+	return 0;
+}
+static int ssd1306_burst_write(struct ssd1306 *oled, const uint8_t *data, int len, write_mode_t mode)
+{
+	uint8_t buff[OLED_WIDTH * max_Y + 1];
+	struct i2c_msg msg = {
+		.addr = oled->addr,
+		.flags = 0,
+		.len = len + 1,
+		.buf = buff};
+	if (len > OLED_WIDTH * max_Y)
+		return -1;
+	if (mode == DATA)
+		buff[0] = 0x40; // data
+	else
+		buff[0] = 0x00; // command
+	memcpy(&buff[1], data, len);
+	return ssd1306_transfer(oled, &msg, 1);
+}
+static int ssd1306_init(struct ssd1306 *oled)
+{
+	usleep(15000);
+	if (ssd1306_burst_write(oled, ssd1306_init_cmds, sizeof(ssd1306_init_cmds), COMMAND) < 0)
+		return -1;
+	// clear screen
+	return ssd1306_clear(oled);
+}
+static int ssd1306_clear(struct ssd1306 *oled)
+{
+	static const uint8_t window[] = {0x21, 0, OLED_WIDTH - 1, 0x22, 0, max_Y - 1};
+	static const uint8_t blank[OLED_WIDTH * max_Y];
+	if (ssd1306_burst_write(oled, window, sizeof(window), COMMAND) < 0 ||
+		ssd1306_burst_write(oled, blank, sizeof(blank), DATA) < 0)
+		return -1;
+	memset(oled->panel_buffer, 0, frame_size);
+	return 0;
+}
+/*
+ * Same policy as the kernel driver: only the changed column span of each
+ * page is sent, but all pages of a frame go out in one I2C_RDWR ioctl.
+ */
+static int ssd1306_sync(struct ssd1306 *oled)
+{
+	static struct i2c_batch batch;
+	int page, first, last, len;
+	uint8_t *src, *dst;
+	batch.count = 0;
+	for (page = 0; page < max_Y; page++)
+	{
+		src = &oled->frame_buffer[page * LINE_SIZE];
+		dst = &oled->panel_buffer[page * LINE_SIZE];
+		for (first = 0; first < LINE_SIZE && src[first] == dst[first]; first++)
+			;
+		if (first == LINE_SIZE)
+			continue;
+		for (last = LINE_SIZE - 1; src[last] == dst[last]; last--)
+			;
+		len = last - first + 1;
+		memcpy(batch.cmd[page], (uint8_t[]){0x00, 0x21, first, last, 0x22, page, page}, 7);
+		batch.msgs[batch.count++] = (struct i2c_msg){
+			.addr = oled->addr, .flags = 0, .len = 7, .buf = batch.cmd[page]};
+		batch.data[page][0] = 0x40;
+		memcpy(&batch.data[page][1], &src[first], len);
+		batch.msgs[batch.count++] = (struct i2c_msg){
+			.addr = oled->addr, .flags = 0, .len = len + 1, .buf = batch.data[page]};
+	}
+	if (!batch.count)
+		return 0;
+	if (ssd1306_transfer(oled, batch.msgs, batch.count) < 0)
+	{
+		perror("ssd1306 sync");
+		return -1;
+	}
+	memcpy(oled->panel_buffer, oled->frame_buffer, frame_size);
+	return 0;
+}
+static int button_open(struct ssd1306 *oled, const char *chip)
+{
+	struct gpio_v2_line_request req;
+	int fd, i;
+	fd = open(chip, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		perror(chip);
+		return -1;
+	}
+	memset(&req, 0, sizeof(req));
+	for (i = 0; i < 4; i++)
+		req.offsets[i] = oled->lines[i];
+	req.num_lines = 4;
+	strcpy(req.consumer, "snake-user");
+	req.config.flags = GPIO_V2_LINE_FLAG_INPUT | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+	if (ioctl(fd, GPIO_V2_GET_LINE_IOCTL, &req) < 0)
+	{
+		perror("GPIO_V2_GET_LINE_IOCTL");
+		close(fd);
+		return -1;
+	}
+	close(fd);
+	oled->line_fd = req.fd;
+	return 0;
+}
+/* Same rules as buttonHandler(), bounces are dropped by event timestamp */
+static void button_read(struct ssd1306 *oled)
+{
+	struct gpio_v2_line_event events[16];
+	ssize_t len;
+	int i, j;
+	len = read(oled->line_fd, events, sizeof(events));
+	for (i = 0; i < len / (ssize_t)sizeof(events[0]); i++)
+	{
+		for (j = 0; j < 4; j++)
+			if (oled->lines[j] == events[i].offset)
+				break;
+		if (j == 4 || events[i].timestamp_ns - oled->last_event[j] < DEBOUNCE_NS)
+			continue;
+		oled->last_event[j] = events[i].timestamp_ns;
+		if (j == BUTTON_UP)
+			snake_game_input(&oled->game, UP);
+		else if (j == BUTTON_DOWN)
+			snake_game_input(&oled->game, DOWN);
+		else if (j == BUTTON_LEFT)
+			snake_game_input(&oled->game, LEFT);
+		else if (j == BUTTON_RIGHT)
+			snake_game_input(&oled->game, RIGHT);
+	}
+}
+/* No start line scrolling here, a moved viewport is sent as changed pages */
+static void snake_game_draw(struct ssd1306 *oled)
+{
+	snake_update_viewport(&oled->game);
+	snake_game_render(&oled->game, oled->frame_buffer);
+	ssd1306_sync(oled);
+}
@@ -12,7 +12,13 @@
 #include <linux/gpio.h>
 #include <linux/interrupt.h>
 #include <linux/moduleparam.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/sysfs.h>
+#include <kunit/static_stub.h>
 #include "ssd1306.h"
+#include "snake_game.h"
 
 #define BUTTON_UP 1
 #define BUTTON_DOWN 0
@@ -26,57 +32,66 @@ const int frame_size = FONT_X * max_X * max_Y;
 static u32 speed = 4;
 module_param(speed, uint, S_IRUGO);
 MODULE_PARM_DESC(speed, "Speed of Snake");
+static u32 world_width = OLED_WIDTH / FONT_X;
+module_param(world_width, uint, S_IRUGO);
+MODULE_PARM_DESC(world_width, "Width of the game world in cells (21 - 256)");
+static u32 world_height = OLED_HEIGHT / 8 - 1;
+module_param(world_height, uint, S_IRUGO);
+MODULE_PARM_DESC(world_height, "Height of the game world in cells (7 - 256)");
 
 struct ssd1306
 {
 	struct i2c_client *client;
-	u8 current_X;
-	u8 current_Y;
 	struct work_struct workqueue;
 	struct timer_list my_timer;
 
+	/* Frame pacing: game ticks run on the timer, a frame every frame_ticks ticks */
+	unsigned long tick_base;
+	u64 tick_count; /* index of the next tick, due at tick_base + tick_count * HZ / speed */
+	unsigned long next_tick;
+	u32 frame_ticks; /* ticks one flush takes, at least 1 */
+	u32 frame_wait; /* ticks since the last frame was queued */
+	u32 flush_us; /* moving average of ssd1306_sync() cost */
+	u32 frames; /* frames that sent bytes to the panel */
+	u32 ticks; /* game ticks run, wraps */
+	u32 window_ticks;
+	unsigned long rate_window;
+	u32 render_fps;
+	u32 tick_fps;
+
 	struct gpio_desc *up;
 	struct gpio_desc *down;
 	struct gpio_desc *left;
 	struct gpio_desc *right;
 
 	u8 *frame_buffer;
-	int current_index;
+	u8 *panel_buffer; /* what the panel GDDRAM holds, indexed by RAM page */
+	u8 start_page;
+	u8 panel_start_page;
+	u8 dirty_pages; /* RAM pages whose last transfer failed, resent in full */
 
-	/* Game Area */
-	bool gameover;
-	control_t button;
+	/* Game Area, the timer, the button irqs and rendering share game under lock */
+	spinlock_t lock;
 	int button_irq[4];
-	u32 score;
-	struct snake *mySnake;
-	struct food myFood;
-	u8 current_length;
+	struct snake_game game;
 };
 
+static int ssd1306_send(struct ssd1306 *oled, const u8 *buff, int len);
 static void ssd1306_write(struct ssd1306 *oled, u8 data, write_mode_t mode);
 static void ssd1306_init(struct ssd1306 *oled);
 static void ssd1306_clear(struct ssd1306 *oled);
-static void ssd1306_goto_xy(struct ssd1306 *oled, u8 x, u8 y);
-static void ssd1306_send_char(struct ssd1306 *oled, u8 data);
-static void ssd1306_send_char_inv(struct ssd1306 *oled, u8 data);
-static void ssd1306_send_string(struct ssd1306 *oled, u8 *str, color_t color);
-static void ssd1306_go_to_next_line(struct ssd1306 *oled);
+static int ssd1306_set_window(struct ssd1306 *oled, u8 col_start, u8 col_end, u8 page);
 static int ssd1306_burst_write(struct ssd1306 *oled, const u8 *data, int len, write_mode_t mode);
 static void ssd1306_sync(struct ssd1306 *oled);
-static int embedded_to_buffer(struct ssd1306 *oled, u8 *data, int start, int length);
 
 static void animation(struct work_struct *work);
 static void tmHandler(struct timer_list *tm);
+static int ssd1306_due_ticks(struct ssd1306 *oled, unsigned long now);
+static bool snake_game_tick(struct ssd1306 *oled, int due);
 irqreturn_t buttonHandler(int irq, void *dev_id);
 
 /* Snake Game Area */
-static void snake_update_score(struct ssd1306 *oled, u32 score);
-static void snake_game_setup(struct ssd1306 *oled);
 static void snake_game_draw(struct ssd1306 *oled);
-static void snake_game_logic(struct ssd1306 *oled);
-static u8 create_random_number(u8 MAX);
-static int add_new_element(struct ssd1306 *oled);
-static void move(struct snake *snk);
 
 static int oled_probe(struct i2c_client *client)
 {
@@ -98,13 +113,16 @@ static int oled_probe(struct i2c_client *client)
 	dev = &client->dev;
 	i2c_set_clientdata(client, oled);
 	ssd1306_init(oled);
-	oled->current_length = 1;
 	oled->frame_buffer = kzalloc(frame_size, GFP_KERNEL);
 	if (!oled->frame_buffer)
 		return -ENOMEM;
-	oled->mySnake = kzalloc(oled->current_length * sizeof(struct snake), GFP_KERNEL);
-	if (!oled->mySnake)
+	oled->panel_buffer = kzalloc(frame_size, GFP_KERNEL);
+	if (!oled->panel_buffer)
 		goto free_frame;
+	if (snake_game_init(&oled->game, world_width, world_height) < 0)
+		goto free_panel;
+	spin_lock_init(&oled->lock);
+	oled->frame_ticks = 1;
 	oled->up = gpiod_get_index(dev, "buttons", BUTTON_UP, GPIOD_IN);
 	oled->down = gpiod_get_index(dev, "buttons", BUTTON_DOWN, GPIOD_IN);
 	oled->left = gpiod_get_index(dev, "buttons", BUTTON_LEFT, GPIOD_IN);
@@ -122,18 +140,22 @@ static int oled_probe(struct i2c_client *client)
 			goto free_snake;
 		}
 	}
-	oled->current_index = 0;
-	snake_game_setup(oled);
 	snake_game_draw(oled);
 
 	INIT_WORK(&oled->workqueue, animation);
 	timer_setup(&oled->my_timer, tmHandler, 0);
-	oled->my_timer.expires = jiffies + HZ;
+	speed = max_t(u32, speed, 1);
+	oled->tick_base = jiffies + HZ;
+	oled->next_tick = oled->tick_base;
+	oled->rate_window = jiffies;
+	oled->my_timer.expires = oled->next_tick;
 	add_timer(&oled->my_timer);
 	pr_info("Start game, speed is: %d\n", speed);
 	return 0;
 free_snake:
-	kfree(oled->mySnake);
+	snake_game_free(&oled->game);
+free_panel:
+	kfree(oled->panel_buffer);
 free_frame:
 	kfree(oled->frame_buffer);
 	return -EFAULT;
@@ -154,14 +176,40 @@ static void oled_remove(struct i2c_client *client)
 		gpiod_put(oled->down);
 		gpiod_put(oled->left);
 		gpiod_put(oled->right);
+		del_timer_sync(&oled->my_timer);
 		cancel_work_sync(&oled->workqueue);
-		del_timer(&oled->my_timer);
 		kfree(oled->frame_buffer);
-		kfree(oled->mySnake);
+		kfree(oled->panel_buffer);
+		snake_game_free(&oled->game);
 		ssd1306_clear(oled);
 		ssd1306_write(oled, 0xAE, COMMAND); // display off
 	}
 }
+static ssize_t render_fps_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct ssd1306 *oled = dev_get_drvdata(dev);
+	return sysfs_emit(buf, "%u\n", oled->render_fps);
+}
+static DEVICE_ATTR_RO(render_fps);
+static ssize_t tick_fps_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct ssd1306 *oled = dev_get_drvdata(dev);
+	return sysfs_emit(buf, "%u\n", oled->tick_fps);
+}
+static DEVICE_ATTR_RO(tick_fps);
+static ssize_t flush_us_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct ssd1306 *oled = dev_get_drvdata(dev);
+	return sysfs_emit(buf, "%u\n", oled->flush_us);
+}
+static DEVICE_ATTR_RO(flush_us);
+static struct attribute *oled_attrs[] = {
+	&dev_attr_render_fps.attr,
+	&dev_attr_tick_fps.attr,
+	&dev_attr_flush_us.attr,
+	NULL};
+ATTRIBUTE_GROUPS(oled);
+
 static const struct i2c_device_id oled_device_id[] = {
 	{.name = "nam", 0},
 	{}};
@@ -180,12 +228,19 @@ static struct i2c_driver oled_driver = {
 		.name = "oled",
 		.owner = THIS_MODULE,
 		.of_match_table = of_match_ptr(oled_of_match_id),
+		.dev_groups = oled_groups,
 	},
 	.id_table = oled_device_id,
 };
 
 module_i2c_driver(oled_driver);
 
+/* Every transfer to the panel goes through here, the KUnit suite swaps it for a fake panel */
+static int ssd1306_send(struct ssd1306 *oled, const u8 *buff, int len)
+{
+	KUNIT_STATIC_STUB_REDIRECT(ssd1306_send, oled, buff, len);
+	return i2c_master_send(oled->client, buff, len);
+}
 static void ssd1306_write(struct ssd1306 *oled, u8 data, write_mode_t mode)
 {
 	/*
@@ -199,7 +254,7 @@ static void ssd1306_write(struct ssd1306 *oled, u8 data, write_mode_t mode)
 	else
 		buff[0] = 0x00; // command
 	buff[1] = data;
-	i2c_master_send(oled->client, buff, 2);
+	ssd1306_send(oled, buff, 2);
 }
 static int ssd1306_burst_write(struct ssd1306 *oled, const u8 *data, int len, write_mode_t mode)
 {
@@ -214,393 +269,209 @@ static int ssd1306_burst_write(struct ssd1306 *oled, const u8 *data, int len, wr
 	else
 		buff[0] = 0x00; // command
 	memcpy(&buff[1], data, len);
-	res = i2c_master_send(oled->client, buff, len + 1);
+	res = ssd1306_send(oled, buff, len + 1);
 	kfree(buff);
 	return res;
 }
 static void ssd1306_init(struct ssd1306 *oled)
 {
 	msleep(15);
-	// set Osc Frequency
-	ssd1306_write(oled, 0xD5, COMMAND);
-	ssd1306_write(oled, 0x80, COMMAND);
-	// set MUX Ratio
-	ssd1306_write(oled, 0xA8, COMMAND);
-	ssd1306_write(oled, 0x3F, COMMAND);
-	// set display offset
-	ssd1306_write(oled, 0xD3, COMMAND);
-	ssd1306_write(oled, 0x00, COMMAND);
-	// set display start line
-	ssd1306_write(oled, 0x40, COMMAND);
-	// Enable charge pump regulator
-	ssd1306_write(oled, 0x8D, COMMAND);
-	ssd1306_write(oled, 0x14, COMMAND);
-	// Set memory addressing mode
-	ssd1306_write(oled, 0x20, COMMAND);
-	ssd1306_write(oled, 0x00, COMMAND);
-	// Set segment remap with column address 0 mapped to segment 0
-	ssd1306_write(oled, 0xA0, COMMAND);
-	ssd1306_write(oled, 0xC0, COMMAND);
-	// set COM Pin hardware configuration
-	ssd1306_write(oled, 0xDA, COMMAND);
-	ssd1306_write(oled, 0x12, COMMAND);
-	// set contrast control
-	ssd1306_write(oled, 0x81, COMMAND);
-	ssd1306_write(oled, 0x7F, COMMAND);
-	// Set pre-charge period
-	ssd1306_write(oled, 0xD9, COMMAND);
-	ssd1306_write(oled, 0xF1, COMMAND);
-	// Set Vcomh deselect level
-	ssd1306_write(oled, 0xDB, COMMAND);
-	ssd1306_write(oled, 0x20, COMMAND);
-	// disable entire display on
-	ssd1306_write(oled, 0xA4, COMMAND);
-	// set normal display
-	ssd1306_write(oled, 0xA6, COMMAND); // A6 normal a7 inverse
-	// set segment re-map
-	ssd1306_write(oled, 0xA0, COMMAND);
-	// deactive scroll
-	ssd1306_write(oled, 0x2E, COMMAND);
-	// display on
-	ssd1306_write(oled, 0xAF, COMMAND);
+	ssd1306_burst_write(oled, ssd1306_init_cmds, sizeof(ssd1306_init_cmds), COMMAND);
 	// clear screen
 	ssd1306_clear(oled);
 }
+/* ssd1306_sync() diffs against a blank panel, a page that did not clear is resent in full */
 static void ssd1306_clear(struct ssd1306 *oled)
 {
-	int i;
-	ssd1306_goto_xy(oled, 0, 0);
-	for (i = 0; i < OLED_WIDTH * (OLED_HEIGHT / 8 - 1); i++)
-		ssd1306_write(oled, 0, DATA);
-}
-static void ssd1306_goto_xy(struct ssd1306 *oled, u8 x, u8 y)
-{
-	ssd1306_write(oled, 0x21, COMMAND);
-	ssd1306_write(oled, x * FONT_X, COMMAND);
-	ssd1306_write(oled, OLED_WIDTH - 1, COMMAND);
-	ssd1306_write(oled, 0x22, COMMAND);
-	ssd1306_write(oled, y, COMMAND);
-	ssd1306_write(oled, max_Y, COMMAND);
-	oled->current_X = x;
-	oled->current_Y = y;
-}
-static void ssd1306_send_char(struct ssd1306 *oled, u8 data)
-{
-	if (oled->current_X == max_X - 1)
-		ssd1306_go_to_next_line(oled);
-	ssd1306_burst_write(oled, ssd1306_font[data - 32], FONT_X, DATA);
-	oled->current_X++;
+	static const u8 blank[OLED_WIDTH];
+	int page;
+	for (page = 0; page < max_Y; page++)
+	{
+		if (ssd1306_set_window(oled, 0, OLED_WIDTH - 1, page) < 0 ||
+			ssd1306_burst_write(oled, blank, sizeof(blank), DATA) < 0)
+			oled->dirty_pages |= BIT(page);
+	}
 }
-static void ssd1306_send_char_inv(struct ssd1306 *oled, u8 data)
+static int ssd1306_set_window(struct ssd1306 *oled, u8 col_start, u8 col_end, u8 page)
 {
-	u8 i;
-	u8 buff[FONT_X];
-	if (oled->current_X == max_X - 1)
-		ssd1306_go_to_next_line(oled);
-	for (i = 0; i < FONT_X; i++)
-		buff[i] = ~ssd1306_font[data - 32][i];
-	ssd1306_burst_write(oled, buff, FONT_X, DATA);
-	oled->current_X++;
+	u8 cmd[] = {
+		0x21, col_start, col_end, // column address
+		0x22, page, page		  // page address
+	};
+	return ssd1306_burst_write(oled, cmd, sizeof(cmd), COMMAND);
 }
-static void ssd1306_send_string(struct ssd1306 *oled, u8 *str, color_t color)
+/*
+ * Screen row i lives in RAM page (i + start_page) % max_Y, the display start
+ * line rotates it to the top. Only the changed column span of each page is
+ * sent, so a vertical scroll costs the exposed page plus the score row.
+ * panel_buffer only takes bytes the panel accepted: a page whose transfer
+ * failed is resent in full by the next sync, a failed start line is retried.
+ */
+static void ssd1306_sync(struct ssd1306 *oled)
 {
-	while (*str)
+	int i, page, first, last;
+	const int line = max_X * FONT_X;
+	u8 *src, *dst;
+	u8 cmd;
+	bool sent = FALSE;
+	ktime_t start = ktime_get();
+	for (i = 0; i < max_Y; i++)
 	{
-		if (color == COLOR_WHITE)
-			ssd1306_send_char(oled, *str++);
+		page = (i + oled->start_page) % max_Y;
+		src = &oled->frame_buffer[i * line];
+		dst = &oled->panel_buffer[page * line];
+		if (oled->dirty_pages & BIT(page))
+		{
+			first = 0;
+			last = line - 1;
+		}
 		else
-			ssd1306_send_char_inv(oled, *str++);
+		{
+			for (first = 0; first < line && src[first] == dst[first]; first++)
+				;
+			if (first == line)
+				continue;
+			for (last = line - 1; src[last] == dst[last]; last--)
+				;
+		}
+		if (ssd1306_set_window(oled, first, last, page) < 0 ||
+			ssd1306_burst_write(oled, &src[first], last - first + 1, DATA) < 0)
+		{
+			oled->dirty_pages |= BIT(page);
+			continue;
+		}
+		memcpy(&dst[first], &src[first], last - first + 1);
+		oled->dirty_pages &= ~BIT(page);
+		sent = TRUE;
 	}
+	if (oled->panel_start_page != oled->start_page)
+	{
+		cmd = 0x40 | (oled->start_page * 8); // set display start line
+		if (ssd1306_burst_write(oled, &cmd, 1, COMMAND) >= 0)
+		{
+			oled->panel_start_page = oled->start_page;
+			sent = TRUE;
+		}
+	}
+	/* A frame identical to the panel is not a rendered frame */
+	if (!sent)
+		return;
+	oled->flush_us = (oled->flush_us * 7 + (u32)ktime_us_delta(ktime_get(), start)) / 8;
+	oled->frames++;
 }
-static void ssd1306_go_to_next_line(struct ssd1306 *oled)
-{
-	oled->current_Y = (oled->current_Y == max_Y - 1) ? 0 : (oled->current_Y + 1);
-	ssd1306_goto_xy(oled, 0, oled->current_Y);
-}
-static int embedded_to_buffer(struct ssd1306 *oled, u8 *data, int start, int length)
+/*
+ * Renders the latest game state. The flush cost sets the frame spacing for
+ * the timer: one frame per ceil(flush_us / tick length) ticks, so the render
+ * rate is the tick rate divided by that and the bus is never queued faster
+ * than it drains. Game speed does not depend on it.
+ */
+static void animation(struct work_struct *work)
 {
-	oled->current_index = FONT_X * start;
-	if (length > frame_size)
-		return -1;
-	for (int i = 0; i < length; i++)
+	struct ssd1306 *oled = container_of(work, struct ssd1306, workqueue);
+	unsigned long elapsed;
+	u32 ticks;
+	if (READ_ONCE(oled->game.gameover) == FALSE)
+		snake_game_draw(oled);
+	else
 	{
-		memcpy(&oled->frame_buffer[oled->current_index], ssd1306_font[*data++ - 32], 6);
-		oled->current_index += 6;
+		embedded_to_buffer(oled->frame_buffer, "Game Over!", 4 * max_X + 5, 10);
+		ssd1306_sync(oled);
+	}
+	WRITE_ONCE(oled->frame_ticks, max_t(u32, DIV_ROUND_UP_ULL((u64)oled->flush_us * speed, USEC_PER_SEC), 1));
+	elapsed = jiffies - oled->rate_window;
+	if (elapsed >= HZ)
+	{
+		ticks = READ_ONCE(oled->ticks);
+		oled->render_fps = oled->frames * HZ / elapsed;
+		oled->tick_fps = (ticks - oled->window_ticks) * HZ / elapsed;
+		oled->frames = 0;
+		oled->window_ticks = ticks;
+		oled->rate_window = jiffies;
 	}
-	return 0;
 }
-static void ssd1306_sync(struct ssd1306 *oled)
+/*
+ * Runs the due game ticks at timer time, each taking the next queued press.
+ * Returns whether a frame should be queued: once frame_ticks ticks have run
+ * since the last one, or right away when the game just ended.
+ */
+static bool snake_game_tick(struct ssd1306 *oled, int due)
 {
-	int i;
-	int index = 0;
-	ssd1306_goto_xy(oled, 0, 0);
-	for (i = 0; i < max_Y; i++)
+	unsigned long flags;
+	bool playing, ended;
+	spin_lock_irqsave(&oled->lock, flags);
+	playing = oled->game.gameover == FALSE;
+	while (due-- > 0 && oled->game.gameover == FALSE)
 	{
-		ssd1306_burst_write(oled, &oled->frame_buffer[index], max_X * FONT_X, DATA);
-		ssd1306_go_to_next_line(oled);
-		index += max_X * FONT_X;
+		snake_game_logic(&oled->game);
+		WRITE_ONCE(oled->ticks, oled->ticks + 1);
+		oled->frame_wait++;
 	}
+	ended = playing && oled->game.gameover;
+	spin_unlock_irqrestore(&oled->lock, flags);
+	if (!ended && oled->frame_wait < READ_ONCE(oled->frame_ticks))
+		return FALSE;
+	oled->frame_wait = 0;
+	return TRUE;
 }
-static void animation(struct work_struct *work)
+/*
+ * Deadlines are rounded from a fixed base rather than stepped by HZ / speed,
+ * so the tick rate does not drift when speed does not divide HZ. Returns the
+ * ticks due by now, several when speed exceeds HZ or the timer ran late.
+ */
+static int ssd1306_due_ticks(struct ssd1306 *oled, unsigned long now)
 {
-	struct ssd1306 *oled = container_of(work, struct ssd1306, workqueue);
-	if (oled)
+	int due = 0;
+	while (time_after_eq(now, oled->next_tick))
 	{
-		if (oled->gameover == FALSE)
-		{
-			snake_game_draw(oled);
-			snake_game_logic(oled);
-		}
-		else
-		{
-			oled->button = PAUSE;
-			ssd1306_goto_xy(oled, 5, 4);
-			ssd1306_send_string(oled, "Game Over!", COLOR_WHITE);
-		}
+		due++;
+		oled->tick_count++;
+		oled->next_tick = oled->tick_base + div_u64(oled->tick_count * HZ + speed / 2, speed);
 	}
-	mod_timer(&oled->my_timer, jiffies + HZ / speed);
+	return due;
 }
 static void tmHandler(struct timer_list *tm)
 {
 	struct ssd1306 *oled = container_of(tm, struct ssd1306, my_timer);
-	if (oled)
+	if (snake_game_tick(oled, ssd1306_due_ticks(oled, jiffies)))
 		schedule_work(&oled->workqueue);
-}
-static u8 create_random_number(u8 MAX)
-{
-	u8 random_number;
-	get_random_bytes(&random_number, sizeof(random_number));
-	return random_number % MAX;
+	mod_timer(&oled->my_timer, oled->next_tick);
 }
 /* Snake Game */
 irqreturn_t buttonHandler(int irq, void *dev_id)
 {
 	struct ssd1306 *oled = (struct ssd1306 *)dev_id;
-	if (irq == oled->button_irq[0] && (oled->mySnake[0].direction != DOWN))
-		oled->button = UP;
-	else if (irq == oled->button_irq[1] && (oled->mySnake[0].direction != UP))
-		oled->button = DOWN;
-	else if (irq == oled->button_irq[2] && (oled->mySnake[0].direction != RIGHT))
-		oled->button = LEFT;
-	else if (irq == oled->button_irq[3] && (oled->mySnake[0].direction != LEFT))
-		oled->button = RIGHT;
+	unsigned long flags;
+	spin_lock_irqsave(&oled->lock, flags);
+	if (irq == oled->button_irq[0])
+		snake_game_input(&oled->game, UP);
+	else if (irq == oled->button_irq[1])
+		snake_game_input(&oled->game, DOWN);
+	else if (irq == oled->button_irq[2])
+		snake_game_input(&oled->game, LEFT);
+	else if (irq == oled->button_irq[3])
+		snake_game_input(&oled->game, RIGHT);
+	spin_unlock_irqrestore(&oled->lock, flags);
 	return IRQ_HANDLED;
 }
-static void snake_game_setup(struct ssd1306 *oled)
-{
-	oled->button = PAUSE;
-	oled->gameover = FALSE;
-	oled->mySnake[0].x = max_X / 2;
-	oled->mySnake[0].y = max_Y / 2;
-	while (!oled->myFood.x)
-		oled->myFood.x = create_random_number(max_X - 2);
-	while (oled->myFood.y < 2)
-		oled->myFood.y = create_random_number(max_Y - 2);
-	snake_update_score(oled, 0);
-}
-static void snake_update_score(struct ssd1306 *oled, u32 score)
-{
-	u8 scoreBuffer[21];
-	memset(scoreBuffer, 0, sizeof(scoreBuffer));
-	sprintf(scoreBuffer, "Score: %d", score);
-	embedded_to_buffer(oled, scoreBuffer, 0, strlen(scoreBuffer));
-}
+/*
+ * A vertical scroll rotates the display start line instead of redrawing every
+ * page. Only the render holds the lock, the flush runs without it.
+ */
 static void snake_game_draw(struct ssd1306 *oled)
 {
-	int i, j, k;
-	bool check = FALSE;
-	oled->current_index = 6 * max_X;
-	memset(oled->frame_buffer, 0, frame_size);
-	for (i = 1; i < max_Y; i++)
-	{
-		for (j = 0; j < max_X; j++)
-		{
-			if (i == 1 || i == max_Y - 1 || j == 0 || j == max_X - 1)
-				memcpy(&oled->frame_buffer[oled->current_index], ssd1306_font['+' - 32], 6);
-			else
-			{
-				if (i == oled->mySnake[0].y && j == oled->mySnake[0].x)
-				{
-					switch (oled->mySnake[0].direction)
-					{
-					case UP:
-						memcpy(&oled->frame_buffer[oled->current_index], ssd1306_font['^' - 32], 6);
-						break;
-					case DOWN:
-						memcpy(&oled->frame_buffer[oled->current_index], ssd1306_font['v' - 32], 6);
-						break;
-					case LEFT:
-						memcpy(&oled->frame_buffer[oled->current_index], ssd1306_font['<' - 32], 6);
-						break;
-					case RIGHT:
-						memcpy(&oled->frame_buffer[oled->current_index], ssd1306_font['>' - 32], 6);
-						break;
-					default:
-						memcpy(&oled->frame_buffer[oled->current_index], ssd1306_font['?' - 32], 6);
-						break;
-					}
-				}
-				else if (i == oled->myFood.y && j == oled->myFood.x)
-					memcpy(&oled->frame_buffer[oled->current_index], ssd1306_font['*' - 32], 6);
-				else
-				{
-					for (k = 1; k < oled->current_length; k++)
-					{
-						if (i == oled->mySnake[k].y && j == oled->mySnake[k].x)
-						{
-							memcpy(&oled->frame_buffer[oled->current_index], ssd1306_font['o' - 32], 6);
-							check = TRUE;
-							break;
-						}
-					}
-					if (!check)
-						memcpy(&oled->frame_buffer[oled->current_index], ssd1306_font[' ' - 32], 6);
-				}
-			}
-			oled->current_index += 6;
-		}
-	}
-	snake_update_score(oled, oled->score);
+	unsigned long flags;
+	int dy;
+	spin_lock_irqsave(&oled->lock, flags);
+	dy = snake_update_viewport(&oled->game);
+	snake_game_render(&oled->game, oled->frame_buffer);
+	spin_unlock_irqrestore(&oled->lock, flags);
+	oled->start_page = (oled->start_page + dy % max_Y + max_Y) % max_Y;
 	ssd1306_sync(oled);
 }
-static void move(struct snake *snk)
-{
-	switch (snk->direction)
-	{
-	case UP:
-		snk->y--;
-		break;
-	case DOWN:
-		snk->y++;
-		break;
-	case LEFT:
-		snk->x--;
-		break;
-	case RIGHT:
-		snk->x++;
-		break;
-	default:
-		break;
-	}
-}
-static void snake_game_logic(struct ssd1306 *oled)
-{
-	u8 i, j;
-	bool die = FALSE;
-	switch (oled->button)
-	{
-	case UP:
-		oled->mySnake[0].direction = UP;
-		oled->mySnake[0].y--;
-		break;
-	case DOWN:
-		oled->mySnake[0].direction = DOWN;
-		oled->mySnake[0].y++;
-		break;
-	case LEFT:
-		oled->mySnake[0].direction = LEFT;
-		oled->mySnake[0].x--;
-		break;
-	case RIGHT:
-		oled->mySnake[0].direction = RIGHT;
-		oled->mySnake[0].x++;
-		break;
-	default:
-		break;
-	}
-	for (i = 1; i < oled->current_length; i++)
-	{
-		switch (oled->mySnake[i - 1].direction)
-		{
-		case UP:
-			if (oled->mySnake[i].x == oled->mySnake[i - 1].x)
-				oled->mySnake[i].direction = UP;
-			move(&oled->mySnake[i]);
-			break;
-		case DOWN:
-			if (oled->mySnake[i].x == oled->mySnake[i - 1].x)
-				oled->mySnake[i].direction = DOWN;
-			move(&oled->mySnake[i]);
-			break;
-		case LEFT:
-			if (oled->mySnake[i].y == oled->mySnake[i - 1].y)
-				oled->mySnake[i].direction = LEFT;
-			move(&oled->mySnake[i]);
-			break;
-		case RIGHT:
-			if (oled->mySnake[i].y == oled->mySnake[i - 1].y)
-				oled->mySnake[i].direction = RIGHT;
-			move(&oled->mySnake[i]);
-			break;
-		default:
-			break;
-		}
-	}
-	for (i = 0; i < oled->current_length; i++) // collision check
-	{
-		for (j = i + 1; j < oled->current_length; j++)
-		{
-			if (oled->mySnake[i].x == oled->mySnake[j].x && oled->mySnake[i].y == oled->mySnake[j].y && oled->current_length > 1)
-			{
-				oled->gameover = TRUE;
-				die = TRUE;
-				break;
-			}
-		}
-		if (die)
-			break;
-	}
-	if (oled->mySnake[0].x <= 0 || oled->mySnake[0].x >= max_X || oled->mySnake[0].y < 2 || oled->mySnake[0].y >= max_Y) // wall collision
-		oled->gameover = TRUE;
-	if (oled->mySnake[0].x == oled->myFood.x && oled->mySnake[0].y == oled->myFood.y) // ate food
-	{
-		add_new_element(oled);
-		oled->myFood.x = 0;
-		oled->myFood.y = 0;
-		while (!oled->myFood.x)
-			oled->myFood.x = create_random_number(max_X - 2);
-		while (oled->myFood.y < 2)
-			oled->myFood.y = create_random_number(max_Y - 2);
-		oled->score += 10;
-	}
-}
-static int add_new_element(struct ssd1306 *oled)
-{
-	u8 new_index = oled->current_length;
-	oled->current_length += 1;
-	struct snake *newSnake = kzalloc(oled->current_length * sizeof(struct snake), GFP_KERNEL);
-	if (!newSnake)
-		return -1;
-	memcpy(newSnake, oled->mySnake, (oled->current_length - 1) * sizeof(struct snake));
-	kfree(oled->mySnake);
-	oled->mySnake = newSnake;
-	switch (oled->mySnake[new_index - 1].direction)
-	{
-	case UP:
-		oled->mySnake[new_index].x = oled->mySnake[new_index - 1].x;
-		oled->mySnake[new_index].y = oled->mySnake[new_index - 1].y + 1;
-		oled->mySnake[new_index].direction = oled->mySnake[new_index - 1].direction;
-		break;
-	case DOWN:
-		oled->mySnake[new_index].x = oled->mySnake[new_index - 1].x;
-		oled->mySnake[new_index].y = oled->mySnake[new_index - 1].y - 1;
-		oled->mySnake[new_index].direction = oled->mySnake[new_index - 1].direction;
-		break;
-	case LEFT:
-		oled->mySnake[new_index].x = oled->mySnake[new_index - 1].x + 1;
-		oled->mySnake[new_index].y = oled->mySnake[new_index - 1].y;
-		oled->mySnake[new_index].direction = oled->mySnake[new_index - 1].direction;
-		break;
-	case RIGHT:
-		oled->mySnake[new_index].x = oled->mySnake[new_index - 1].x - 1;
-		oled->mySnake[new_index].y = oled->mySnake[new_index - 1].y;
-		oled->mySnake[new_index].direction = oled->mySnake[new_index - 1].direction;
-		break;
-	default:
-		break;
-	}
-	return 0;
-}
+
+#ifdef CONFIG_SSD1306_SNAKE_KUNIT_TEST
+#include "ssd1306_test.c"
+#endif
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("DinhNam <20021163@vnu.edu.vn>");
@@ -102,6 +102,25 @@ const uint8_t ssd1306_font[][FONT_X] = {
 		{0x00, 0x82, 0x7C, 0x10, 0x00, 0x00}, // }
 		{0x00, 0x06, 0x09, 0x09, 0x06, 0x00}	// ~ (Degrees)
 };
+/* Power-up command sequence, sent after a 15 ms reset delay */
+const uint8_t ssd1306_init_cmds[] = {
+		0xD5, 0x80, // set Osc Frequency
+		0xA8, 0x3F, // set MUX Ratio
+		0xD3, 0x00, // set display offset
+		0x40,		// set display start line
+		0x8D, 0x14, // Enable charge pump regulator
+		0x20, 0x00, // Set memory addressing mode
+		0xA0, 0xC0, // Set segment remap with column address 0 mapped to segment 0
+		0xDA, 0x12, // set COM Pin hardware configuration
+		0x81, 0x7F, // set contrast control
+		0xD9, 0xF1, // Set pre-charge period
+		0xDB, 0x20, // Set Vcomh deselect level
+		0xA4,		// disable entire display on
+		0xA6,		// set normal display, A6 normal a7 inverse
+		0xA0,		// set segment re-map
+		0x2E,		// deactive scroll
+		0xAF		// display on
+};
 typedef enum {
 	PAUSE,
 	UP,
@@ -0,0 +1,818 @@
+/*
+ * KUnit tests for the snake game and the frame path of the ssd1306 driver.
+ * Included at the end of ssd1306.c so the static functions are reachable.
+ * ssd1306_send() is replaced by a fake panel that decodes the command
+ * stream into its own GDDRAM, so a test can check what the display would show.
+ *
+ * ./tools/testing/kunit/kunit.py run --kunitconfig=<path to this directory>
+ */
+#include <kunit/test.h>
+#include <kunit/static_stub.h>
+
+/* Fake panel: horizontal addressing mode, column/page window and start line */
+struct fake_panel
+{
+	u8 ram[OLED_HEIGHT / 8][OLED_WIDTH];
+	u8 col, col_start, col_end;
+	u8 page, page_start, page_end;
+	u8 start_line;
+	u8 cmd[7]; /* command still waiting for its arguments */
+	int cmd_len;
+	int bad_args; /* window arguments out of range, the controller would mask them */
+	u32 bytes; /* bytes on the bus, control bytes included */
+	int fail; /* sends still to fail with -EIO, nothing reaches the panel */
+};
+
+struct snake_test
+{
+	struct ssd1306 oled;
+	struct fake_panel panel;
+};
+
+/* Argument bytes that follow a command, from the SSD1306 command table */
+static int fake_command_args(u8 cmd)
+{
+	switch (cmd)
+	{
+	case 0x21: // column address
+	case 0x22: // page address
+	case 0xA3: // vertical scroll area
+		return 2;
+	case 0x26: // horizontal scroll setup
+	case 0x27:
+		return 6;
+	case 0x29: // vertical and horizontal scroll setup
+	case 0x2A:
+		return 5;
+	case 0x20: // memory addressing mode
+	case 0x81: // contrast
+	case 0x8D: // charge pump
+	case 0xA8: // multiplex ratio
+	case 0xD3: // display offset
+	case 0xD5: // clock divide
+	case 0xD9: // pre-charge period
+	case 0xDA: // COM pins
+	case 0xDB: // Vcomh level
+		return 1;
+	default:
+		return 0;
+	}
+}
+static void fake_panel_command(struct fake_panel *panel, u8 byte)
+{
+	panel->cmd[panel->cmd_len++] = byte;
+	if (panel->cmd_len <= fake_command_args(panel->cmd[0]))
+		return;
+	switch (panel->cmd[0])
+	{
+	case 0x21:
+		if (panel->cmd[1] >= OLED_WIDTH || panel->cmd[2] >= OLED_WIDTH)
+			panel->bad_args++;
+		panel->col_start = panel->cmd[1] % OLED_WIDTH;
+		panel->col_end = panel->cmd[2] % OLED_WIDTH;
+		panel->col = panel->col_start;
+		break;
+	case 0x22:
+		if (panel->cmd[1] >= OLED_HEIGHT / 8 || panel->cmd[2] >= OLED_HEIGHT / 8)
+			panel->bad_args++;
+		panel->page_start = panel->cmd[1] % (OLED_HEIGHT / 8);
+		panel->page_end = panel->cmd[2] % (OLED_HEIGHT / 8);
+		panel->page = panel->page_start;
+		break;
+	default:
+		if (panel->cmd[0] >= 0x40 && panel->cmd[0] <= 0x7F)
+			panel->start_line = panel->cmd[0] & 0x3F;
+		break;
+	}
+	panel->cmd_len = 0;
+}
+static void fake_panel_data(struct fake_panel *panel, u8 byte)
+{
+	panel->ram[panel->page][panel->col] = byte;
+	if (panel->col++ < panel->col_end)
+		return;
+	panel->col = panel->col_start;
+	panel->page = panel->page < panel->page_end ? panel->page + 1 : panel->page_start;
+}
+/* Stands in for i2c_master_send(): control byte, then commands or data */
+static int fake_send(struct ssd1306 *oled, const u8 *buff, int len)
+{
+	struct fake_panel *panel = &container_of(oled, struct snake_test, oled)->panel;
+	int i;
+	if (panel->fail > 0)
+	{
+		panel->fail--;
+		return -EIO;
+	}
+	for (i = 1; i < len; i++)
+	{
+		if (buff[0] == 0x40)
+			fake_panel_data(panel, buff[i]);
+		else
+			fake_panel_command(panel, buff[i]);
+	}
+	panel->bytes += len;
+	return len;
+}
+
+/* Turns a row of glyphs back into text, '#' for a cell that is not a glyph */
+static void decode_row(const u8 *line, char *text)
+{
+	int i, c;
+	for (i = 0; i < max_X; i++)
+	{
+		text[i] = '#';
+		for (c = 0; c < ARRAY_SIZE(ssd1306_font); c++)
+		{
+			if (!memcmp(&line[i * FONT_X], ssd1306_font[c], FONT_X))
+			{
+				text[i] = ' ' + c;
+				break;
+			}
+		}
+	}
+	text[max_X] = '\0';
+}
+static void expect_frame(struct kunit *test, const u8 *frame, const char *const *golden)
+{
+	char text[VIEW_COLS + 1];
+	int i;
+	for (i = 0; i < max_Y; i++)
+	{
+		decode_row(&frame[i * SNAKE_LINE_SIZE], text);
+		KUNIT_EXPECT_STREQ_MSG(test, text, golden[i], "frame row %d", i);
+	}
+}
+/* What the panel shows: screen row i is RAM page (i + start_line / 8) % 8 */
+static void expect_panel(struct kunit *test, const struct fake_panel *panel, const char *const *golden)
+{
+	char text[VIEW_COLS + 1];
+	int i;
+	KUNIT_EXPECT_EQ(test, panel->start_line % 8, 0);
+	for (i = 0; i < max_Y; i++)
+	{
+		decode_row(panel->ram[(i + panel->start_line / 8) % max_Y], text);
+		KUNIT_EXPECT_STREQ_MSG(test, text, golden[i], "panel row %d", i);
+	}
+}
+
+/* Replaces the snake, segments[0] is the head, the next move keeps its direction */
+static void set_snake(struct kunit *test, struct snake_game *game, const struct snake *segments, int length)
+{
+	int i;
+	KUNIT_ASSERT_LE(test, length, game->max_length);
+	memcpy(game->mySnake, segments, length * sizeof(struct snake));
+	game->head_index = 0;
+	game->current_length = length;
+	memset(game->occupied, 0, (game->world_width * game->world_height + 7) / 8);
+	for (i = 0; i < length; i++)
+		world_set(game, segments[i].x, segments[i].y);
+	game->button = segments[0].direction;
+	game->heading = segments[0].direction;
+	game->input_count = 0;
+}
+static void set_food(struct snake_game *game, u8 x, u8 y)
+{
+	game->myFood.x = x;
+	game->myFood.y = y;
+}
+
+static int snake_test_init(struct kunit *test)
+{
+	struct snake_test *ctx = kunit_kzalloc(test, sizeof(*ctx), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, ctx);
+	test->priv = ctx;
+	ctx->oled.frame_buffer = kunit_kzalloc(test, frame_size, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, ctx->oled.frame_buffer);
+	ctx->oled.panel_buffer = kunit_kzalloc(test, frame_size, GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, ctx->oled.panel_buffer);
+	KUNIT_ASSERT_EQ(test, snake_game_init(&ctx->oled.game, max_X, max_Y - 1), 0);
+	spin_lock_init(&ctx->oled.lock);
+	ctx->oled.frame_ticks = 1;
+	kunit_activate_static_stub(test, ssd1306_send, fake_send);
+	return 0;
+}
+static void snake_test_exit(struct kunit *test)
+{
+	struct snake_test *ctx = test->priv;
+	snake_game_free(&ctx->oled.game);
+}
+
+static void embedded_to_buffer_test(struct kunit *test)
+{
+	struct snake_test *ctx = test->priv;
+	u8 *frame = ctx->oled.frame_buffer;
+	char text[VIEW_COLS + 1];
+	KUNIT_EXPECT_EQ(test, embedded_to_buffer(frame, "Hi", 2 * max_X + 3, 2), 0);
+	decode_row(&frame[2 * SNAKE_LINE_SIZE], text);
+	KUNIT_EXPECT_STREQ(test, text, "   Hi                ");
+	/* The last cell fits, one past it or before the frame does not */
+	KUNIT_EXPECT_EQ(test, embedded_to_buffer(frame, "!", max_X * max_Y - 1, 1), 0);
+	KUNIT_EXPECT_EQ(test, embedded_to_buffer(frame, "!!", max_X * max_Y - 1, 2), -1);
+	KUNIT_EXPECT_EQ(test, embedded_to_buffer(frame, "!", -1, 1), -1);
+	decode_row(&frame[(max_Y - 1) * SNAKE_LINE_SIZE], text);
+	KUNIT_EXPECT_STREQ(test, text, "                    !");
+}
+
+static void snake_game_draw_test(struct kunit *test)
+{
+	static const char *const golden[] = {
+		"Score: 0             ",
+		"+++++++++++++++++++++",
+		"+                   +",
+		"+              *    +",
+		"+         ?         +",
+		"+                   +",
+		"+                   +",
+		"+++++++++++++++++++++",
+	};
+	struct snake_test *ctx = test->priv;
+	u32 bytes;
+	set_food(&ctx->oled.game, 15, 2);
+	snake_game_draw(&ctx->oled);
+	expect_frame(test, ctx->oled.frame_buffer, golden);
+	expect_panel(test, &ctx->panel, golden);
+	KUNIT_EXPECT_EQ(test, ctx->oled.frames, 1);
+	/* Nothing changed: no bytes on the bus and no frame counted */
+	bytes = ctx->panel.bytes;
+	snake_game_draw(&ctx->oled);
+	KUNIT_EXPECT_EQ(test, ctx->panel.bytes, bytes);
+	KUNIT_EXPECT_EQ(test, ctx->oled.frames, 1);
+}
+
+static void snake_game_logic_move_test(struct kunit *test)
+{
+	static const char *const golden[] = {
+		"Score: 0             ",
+		"+++++++++++++++++++++",
+		"+                   +",
+		"+              *    +",
+		"+          >        +",
+		"+                   +",
+		"+                   +",
+		"+++++++++++++++++++++",
+	};
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	set_food(game, 15, 2);
+	/* Paused until the first button */
+	snake_game_logic(game);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 0)->x, 10);
+	snake_game_input(game, RIGHT);
+	snake_game_logic(game);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 0)->x, 11);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 0)->y, 3);
+	KUNIT_EXPECT_TRUE(test, world_test(game, 11, 3));
+	KUNIT_EXPECT_FALSE(test, world_test(game, 10, 3));
+	/* No turning back onto the body, and no repeating the last move */
+	snake_game_input(game, LEFT);
+	snake_game_input(game, RIGHT);
+	KUNIT_EXPECT_EQ(test, game->input_count, 0);
+	snake_game_draw(&ctx->oled);
+	expect_frame(test, ctx->oled.frame_buffer, golden);
+	expect_panel(test, &ctx->panel, golden);
+}
+
+static void add_new_element_test(struct kunit *test)
+{
+	static const struct snake segments[] = {{8, 3, RIGHT}, {7, 3, RIGHT}, {6, 3, RIGHT}};
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	set_snake(test, game, segments, ARRAY_SIZE(segments));
+	KUNIT_ASSERT_EQ(test, add_new_element(game), 0);
+	KUNIT_EXPECT_EQ(test, game->current_length, 4);
+	/* The new segment is a copy of the tail and leaves the body untouched */
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 0)->x, 8);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 3)->x, 6);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 3)->y, 3);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 2)->x, 6);
+}
+
+/* Eating keeps the tail in place for one tick, the head carries on forward */
+static void snake_growth_test(struct kunit *test)
+{
+	static const char *const golden[] = {
+		"Score: 10            ",
+		"+++++++++++++++++++++",
+		"+                   +",
+		"+                   +",
+		"+     ooo>          +",
+		"+                   +",
+		"+                 * +",
+		"+++++++++++++++++++++",
+	};
+	static const char *const golden_next[] = {
+		"Score: 10            ",
+		"+++++++++++++++++++++",
+		"+                   +",
+		"+                   +",
+		"+      ooo>         +",
+		"+                   +",
+		"+                 * +",
+		"+++++++++++++++++++++",
+	};
+	static const struct snake segments[] = {{8, 3, RIGHT}, {7, 3, RIGHT}, {6, 3, RIGHT}};
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	set_snake(test, game, segments, ARRAY_SIZE(segments));
+	set_food(game, 9, 3);
+	snake_game_logic(game);
+	KUNIT_EXPECT_EQ(test, game->current_length, 4);
+	KUNIT_EXPECT_EQ(test, game->score, 10);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 0)->x, 9);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 3)->x, 6);
+	KUNIT_EXPECT_TRUE(test, world_test(game, 6, 3));
+	KUNIT_EXPECT_FALSE(test, game->gameover);
+	set_food(game, 18, 5);
+	snake_game_draw(&ctx->oled);
+	expect_frame(test, ctx->oled.frame_buffer, golden);
+	expect_panel(test, &ctx->panel, golden);
+	snake_game_logic(game);
+	KUNIT_EXPECT_EQ(test, game->current_length, 4);
+	KUNIT_EXPECT_FALSE(test, world_test(game, 6, 3));
+	snake_game_draw(&ctx->oled);
+	expect_frame(test, ctx->oled.frame_buffer, golden_next);
+	expect_panel(test, &ctx->panel, golden_next);
+}
+
+/* Runs through the work handler so the game over screen is covered too */
+static void snake_wall_collision_test(struct kunit *test)
+{
+	static const char *const golden[] = {
+		"Score: 0             ",
+		"+++++++++++++++++++++",
+		"+                   +",
+		"+              *    +",
+		"+<o  Game Over!     +",
+		"+                   +",
+		"+                   +",
+		"+++++++++++++++++++++",
+	};
+	static const struct snake segments[] = {{1, 3, LEFT}, {2, 3, LEFT}};
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	set_snake(test, game, segments, ARRAY_SIZE(segments));
+	set_food(game, 15, 2);
+	snake_game_draw(&ctx->oled);
+	/* The tick that ends the game asks for a frame even between frame_ticks */
+	ctx->oled.frame_ticks = 4;
+	KUNIT_EXPECT_TRUE(test, snake_game_tick(&ctx->oled, 1));
+	animation(&ctx->oled.workqueue);
+	KUNIT_EXPECT_TRUE(test, game->gameover);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 0)->x, 0);
+	expect_frame(test, ctx->oled.frame_buffer, golden);
+	expect_panel(test, &ctx->panel, golden);
+	/* Ticks after the game is over are dropped */
+	KUNIT_EXPECT_FALSE(test, snake_game_tick(&ctx->oled, 3));
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 0)->x, 0);
+	KUNIT_EXPECT_EQ(test, ctx->oled.ticks, 1);
+}
+
+/* Two turns pressed between ticks are both taken, one per tick */
+static void snake_input_queue_test(struct kunit *test)
+{
+	static const struct snake segments[] = {{8, 3, RIGHT}, {7, 3, RIGHT}, {6, 3, RIGHT}};
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	int i;
+	set_snake(test, game, segments, ARRAY_SIZE(segments));
+	set_food(game, 15, 5);
+	snake_game_input(game, DOWN);
+	snake_game_input(game, LEFT);
+	KUNIT_EXPECT_EQ(test, game->input_count, 2);
+	snake_game_logic(game);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 0)->x, 8);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 0)->y, 4);
+	snake_game_logic(game);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 0)->x, 7);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 0)->y, 4);
+	KUNIT_EXPECT_EQ(test, game->input_count, 0);
+	KUNIT_EXPECT_FALSE(test, game->gameover);
+	/* Each press is checked against the one queued before it */
+	snake_game_input(game, RIGHT);
+	snake_game_input(game, UP);
+	snake_game_input(game, DOWN);
+	KUNIT_EXPECT_EQ(test, game->input_count, 1);
+	KUNIT_EXPECT_EQ(test, game->input[0], UP);
+	/* A full queue drops further presses */
+	for (i = 0; i < 2 * SNAKE_INPUT_DEPTH; i++)
+		snake_game_input(game, i % 2 ? UP : LEFT);
+	KUNIT_EXPECT_EQ(test, game->input_count, SNAKE_INPUT_DEPTH);
+}
+
+/* A frame is asked for every frame_ticks ticks, frame_ticks follows the flush cost */
+static void snake_frame_pacing_test(struct kunit *test)
+{
+	struct snake_test *ctx = test->priv;
+	struct ssd1306 *oled = &ctx->oled;
+	int i, frames = 0;
+	oled->frame_ticks = 3;
+	for (i = 0; i < 12; i++)
+		frames += snake_game_tick(oled, 1);
+	KUNIT_EXPECT_EQ(test, frames, 4);
+	KUNIT_EXPECT_TRUE(test, snake_game_tick(oled, 5));
+	/* A flush of 1.5 tick lengths spaces frames two ticks apart */
+	snake_game_draw(oled);
+	oled->flush_us = 3 * USEC_PER_SEC / (2 * speed);
+	animation(&oled->workqueue);
+	KUNIT_EXPECT_EQ(test, oled->frame_ticks, 2);
+	oled->flush_us = 0;
+	animation(&oled->workqueue);
+	KUNIT_EXPECT_EQ(test, oled->frame_ticks, 1);
+}
+
+/* Leaving the world keeps the head off the occupancy bitmap */
+static void snake_off_world_test(struct kunit *test)
+{
+	static const struct snake segments[] = {{0, 3, LEFT}, {1, 3, LEFT}};
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	set_snake(test, game, segments, ARRAY_SIZE(segments));
+	snake_game_logic(game);
+	KUNIT_EXPECT_TRUE(test, game->gameover);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 0)->x, 255);
+	KUNIT_EXPECT_FALSE(test, world_test(game, 1, 3));
+	KUNIT_EXPECT_TRUE(test, world_test(game, 0, 3));
+}
+
+static void snake_self_collision_test(struct kunit *test)
+{
+	static const struct snake segments[] = {
+		{5, 3, UP}, {5, 4, LEFT}, {6, 4, LEFT}, {6, 3, DOWN}, {6, 2, DOWN}, {5, 2, RIGHT}};
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	set_snake(test, game, segments, ARRAY_SIZE(segments));
+	snake_game_input(game, RIGHT);
+	snake_game_logic(game);
+	KUNIT_EXPECT_TRUE(test, game->gameover);
+	/* Moving into the cell the tail leaves on this tick is fine */
+	set_snake(test, game, segments, ARRAY_SIZE(segments));
+	game->gameover = false;
+	snake_game_logic(game);
+	KUNIT_EXPECT_FALSE(test, game->gameover);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 0)->y, 2);
+}
+
+/* A snake covering every cell stops growing, still scores and runs into itself */
+static void snake_length_cap_test(struct kunit *test)
+{
+	static const char *const golden[] = {
+		"Score: 10            ",
+		"+++++++++++++++++++++",
+		"+ooooooooooooooooooo+",
+		"+ooooooooooooooooooo+",
+		"+ooooooooo<ooooooooo+",
+		"+ooooooooooooooooooo+",
+		"+ooooooooooooooooooo+",
+		"+++++++++++++++++++++",
+	};
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	int cap = game->world_width * game->world_height;
+	struct snake *segments = kunit_kcalloc(test, cap, sizeof(*segments), GFP_KERNEL);
+	int i = 1, x, y;
+	KUNIT_ASSERT_NOT_NULL(test, segments);
+	/* Head at (11, 3) heading left, every other cell is body */
+	segments[0] = (struct snake){11, 3, LEFT};
+	for (y = 0; y < game->world_height; y++)
+		for (x = 0; x < game->world_width; x++)
+			if (x != 11 || y != 3)
+				segments[i++] = (struct snake){x, y, LEFT};
+	set_snake(test, game, segments, cap);
+	KUNIT_EXPECT_EQ(test, add_new_element(game), -1);
+	KUNIT_EXPECT_EQ(test, game->current_length, cap);
+	set_food(game, 10, 3);
+	snake_game_logic(game);
+	KUNIT_EXPECT_EQ(test, game->current_length, cap);
+	KUNIT_EXPECT_EQ(test, game->score, 10);
+	KUNIT_EXPECT_EQ(test, snake_segment(game, 0)->x, 10);
+	KUNIT_EXPECT_TRUE(test, game->gameover);
+	set_food(game, 0, 0);
+	snake_game_draw(&ctx->oled);
+	expect_frame(test, ctx->oled.frame_buffer, golden);
+	expect_panel(test, &ctx->panel, golden);
+}
+
+/* New food only lands on free interior cells, a full world parks it on the border */
+static void snake_food_test(struct kunit *test)
+{
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	int i, x, y;
+	for (y = 1; y < game->world_height - 1; y++)
+		for (x = 1; x < game->world_width - 1; x++)
+			if (x != 7 || y != 4)
+				world_set(game, x, y);
+	for (i = 0; i < 32; i++)
+	{
+		snake_new_food(game);
+		KUNIT_EXPECT_EQ(test, game->myFood.x, 7);
+		KUNIT_EXPECT_EQ(test, game->myFood.y, 4);
+	}
+	world_set(game, 7, 4);
+	snake_new_food(game);
+	KUNIT_EXPECT_EQ(test, game->myFood.x, 0);
+	KUNIT_EXPECT_EQ(test, game->myFood.y, 0);
+}
+
+/* Food outside the viewport is pointed at from the score row */
+static void snake_food_hint_test(struct kunit *test)
+{
+	static const struct
+	{
+		u8 x, y;
+		const char *row;
+	} cases[] = {
+		{10, 250, "Score: 0          *v<"},
+		{200, 128, "Score: 0          * >"},
+		{128, 3, "Score: 0          *^ "},
+		{130, 127, "Score: 0             "},
+	};
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	char text[VIEW_COLS + 1];
+	int i;
+	snake_game_free(game);
+	KUNIT_ASSERT_EQ(test, snake_game_init(game, WORLD_MAX, WORLD_MAX), 0);
+	for (i = 0; i < ARRAY_SIZE(cases); i++)
+	{
+		set_food(game, cases[i].x, cases[i].y);
+		snake_game_draw(&ctx->oled);
+		decode_row(ctx->oled.frame_buffer, text);
+		KUNIT_EXPECT_STREQ_MSG(test, text, cases[i].row, "food at %d,%d", cases[i].x, cases[i].y);
+	}
+}
+
+/* A vertical scroll moves the start line and only sends the exposed rows */
+static void snake_scroll_test(struct kunit *test)
+{
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	char frame[VIEW_ROWS + 1][VIEW_COLS + 1];
+	const char *golden[VIEW_ROWS + 1];
+	u32 bytes;
+	int i, step;
+	snake_game_free(game);
+	KUNIT_ASSERT_EQ(test, snake_game_init(game, 64, 64), 0);
+	snake_game_draw(&ctx->oled);
+	snake_game_input(game, UP);
+	for (step = 0; step < 12; step++)
+	{
+		u8 start_page = ctx->oled.start_page;
+		snake_game_logic(game);
+		bytes = ctx->panel.bytes;
+		snake_game_draw(&ctx->oled);
+		for (i = 0; i <= VIEW_ROWS; i++)
+		{
+			decode_row(&ctx->oled.frame_buffer[i * SNAKE_LINE_SIZE], frame[i]);
+			golden[i] = frame[i];
+		}
+		expect_panel(test, &ctx->panel, golden);
+		/* The score row lands on a new page and one viewport row is exposed */
+		if (ctx->oled.start_page != start_page)
+			KUNIT_EXPECT_LT(test, ctx->panel.bytes - bytes, 3 * SNAKE_LINE_SIZE);
+	}
+	KUNIT_EXPECT_FALSE(test, game->gameover);
+	KUNIT_EXPECT_NE(test, ctx->oled.start_page, 0);
+}
+
+/*
+ * Ticks land on rounded deadlines from one base, so 60 s hold 60 * speed ticks
+ * plus the one at the base. Rounding moves a deadline by half a tick at most.
+ */
+static void ssd1306_tick_schedule_test(struct kunit *test)
+{
+	static const u32 speeds[] = {3, 7, 4 * HZ};
+	struct snake_test *ctx = test->priv;
+	struct ssd1306 *oled = &ctx->oled;
+	u32 saved = speed;
+	unsigned long now;
+	int i, due;
+	for (i = 0; i < ARRAY_SIZE(speeds); i++)
+	{
+		speed = speeds[i];
+		oled->tick_base = 1000;
+		oled->tick_count = 0;
+		oled->next_tick = oled->tick_base;
+		due = 0;
+		for (now = oled->tick_base; now <= oled->tick_base + 60 * HZ; now++)
+			due += ssd1306_due_ticks(oled, now);
+		KUNIT_EXPECT_GT(test, due, 60 * speeds[i]);
+		KUNIT_EXPECT_LT(test, due, 60 * speeds[i] + 3);
+		KUNIT_EXPECT_TRUE(test, time_after(oled->next_tick, now - 1));
+	}
+	speed = saved;
+}
+
+/* Init must leave every RAM page blank, ssd1306_sync() starts from a zeroed shadow */
+static void ssd1306_init_test(struct kunit *test)
+{
+	struct snake_test *ctx = test->priv;
+	int page, col;
+	memset(ctx->panel.ram, 0xA5, sizeof(ctx->panel.ram));
+	ctx->panel.start_line = 13;
+	ssd1306_init(&ctx->oled);
+	KUNIT_EXPECT_EQ(test, ctx->panel.cmd_len, 0);
+	KUNIT_EXPECT_EQ(test, ctx->panel.bad_args, 0);
+	KUNIT_EXPECT_EQ(test, ctx->panel.start_line, 0);
+	KUNIT_EXPECT_EQ(test, ctx->oled.dirty_pages, 0);
+	for (page = 0; page < OLED_HEIGHT / 8; page++)
+		for (col = 0; col < OLED_WIDTH; col++)
+			KUNIT_EXPECT_EQ_MSG(test, ctx->panel.ram[page][col], 0, "page %d col %d", page, col);
+	/* A page that fails to clear is resent by the first sync */
+	memset(ctx->panel.ram, 0xA5, sizeof(ctx->panel.ram));
+	ctx->panel.fail = 1;
+	ssd1306_clear(&ctx->oled);
+	KUNIT_EXPECT_EQ(test, ctx->oled.dirty_pages, BIT(0));
+}
+
+/* A failed transfer leaves the shadow alone, so the next sync sends it again */
+static void snake_sync_retry_test(struct kunit *test)
+{
+	static const char *const before[] = {
+		"Score: 0             ",
+		"+++++++++++++++++++++",
+		"+                   +",
+		"+              *    +",
+		"+         ?         +",
+		"+                   +",
+		"+                   +",
+		"+++++++++++++++++++++",
+	};
+	static const char *const after[] = {
+		"Score: 0             ",
+		"+++++++++++++++++++++",
+		"+                   +",
+		"+              *    +",
+		"+          >        +",
+		"+                   +",
+		"+                   +",
+		"+++++++++++++++++++++",
+	};
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	char frame[VIEW_ROWS + 1][VIEW_COLS + 1];
+	const char *golden[VIEW_ROWS + 1];
+	u32 bytes;
+	int i;
+	set_food(game, 15, 2);
+	snake_game_draw(&ctx->oled);
+	snake_game_input(game, RIGHT);
+	snake_game_logic(game);
+	/* The window command of the only changed page fails */
+	ctx->panel.fail = 1;
+	snake_game_draw(&ctx->oled);
+	expect_panel(test, &ctx->panel, before);
+	KUNIT_EXPECT_EQ(test, ctx->oled.frames, 1);
+	/* Same frame again: the whole page goes out, window plus 126 data bytes */
+	bytes = ctx->panel.bytes;
+	snake_game_draw(&ctx->oled);
+	expect_panel(test, &ctx->panel, after);
+	KUNIT_EXPECT_EQ(test, ctx->panel.bytes - bytes, 7 + SNAKE_LINE_SIZE + 1);
+	KUNIT_EXPECT_EQ(test, ctx->oled.frames, 2);
+	KUNIT_EXPECT_EQ(test, ctx->oled.dirty_pages, 0);
+
+	/* A scroll where every transfer fails, start line included */
+	snake_game_free(game);
+	KUNIT_ASSERT_EQ(test, snake_game_init(game, 64, 64), 0);
+	snake_game_draw(&ctx->oled);
+	snake_game_input(game, UP);
+	for (i = 0; i < 2; i++)
+		snake_game_logic(game);
+	ctx->panel.fail = 100;
+	snake_game_draw(&ctx->oled);
+	KUNIT_EXPECT_NE(test, ctx->oled.start_page, 0);
+	KUNIT_EXPECT_EQ(test, ctx->oled.panel_start_page, 0);
+	ctx->panel.fail = 0;
+	snake_game_draw(&ctx->oled);
+	KUNIT_EXPECT_EQ(test, ctx->oled.panel_start_page, ctx->oled.start_page);
+	for (i = 0; i <= VIEW_ROWS; i++)
+	{
+		decode_row(&ctx->oled.frame_buffer[i * SNAKE_LINE_SIZE], frame[i]);
+		golden[i] = frame[i];
+	}
+	expect_panel(test, &ctx->panel, golden);
+}
+
+#define SNAKE_BENCH_ITERATIONS 1000
+
+static const u16 snake_bench_lengths[] = {1, 16, 256, 4096};
+
+static void snake_bench_desc(const u16 *length, char *desc)
+{
+	snprintf(desc, KUNIT_PARAM_DESC_SIZE, "length %u", *length);
+}
+KUNIT_ARRAY_PARAM(snake_bench, snake_bench_lengths, snake_bench_desc);
+
+/* Snake of the given length folded through a 256 x 256 world, head at (2, 2) */
+static void snake_bench_setup(struct kunit *test, u16 length)
+{
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	struct snake *segments = kunit_kcalloc(test, length, sizeof(*segments), GFP_KERNEL);
+	int i, pos, row, col;
+	KUNIT_ASSERT_NOT_NULL(test, segments);
+	snake_game_free(game);
+	KUNIT_ASSERT_EQ(test, snake_game_init(game, WORLD_MAX, WORLD_MAX), 0);
+	/* The tail starts at the bottom left, the head ends the top row of the body */
+	for (i = 0; i < length; i++)
+	{
+		pos = length - 1 - i;
+		row = pos / (WORLD_MAX - 4);
+		col = pos % (WORLD_MAX - 4);
+		segments[i].x = row % 2 ? WORLD_MAX - 3 - col : 2 + col;
+		segments[i].y = WORLD_MAX - 3 - row;
+		segments[i].direction = row % 2 ? LEFT : RIGHT;
+	}
+	set_snake(test, game, segments, length);
+	set_food(game, WORLD_MAX - 2, WORLD_MAX - 2);
+	snake_game_draw(&ctx->oled);
+}
+/*
+ * The head carries on along the serpentine the body lies on, into the free
+ * rows above it, so the snake never runs into itself or the border.
+ */
+static void snake_bench_turn(struct snake_game *game)
+{
+	const struct snake *head = snake_segment(game, 0);
+	if ((WORLD_MAX - 3 - head->y) % 2)
+		game->button = head->x == 2 ? UP : LEFT;
+	else
+		game->button = head->x == WORLD_MAX - 3 ? UP : RIGHT;
+}
+
+static void snake_bench_tick(struct kunit *test)
+{
+	const u16 *length = test->param_value;
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	ktime_t start;
+	s64 ns;
+	int i;
+	snake_bench_setup(test, *length);
+	start = ktime_get();
+	for (i = 0; i < SNAKE_BENCH_ITERATIONS; i++)
+	{
+		snake_bench_turn(game);
+		snake_game_logic(game);
+	}
+	ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	KUNIT_EXPECT_EQ(test, game->current_length, *length);
+	KUNIT_EXPECT_FALSE(test, game->gameover);
+	kunit_info(test, "length %u: %lld ns/tick\n", *length, div_s64(ns, SNAKE_BENCH_ITERATIONS));
+}
+
+static void snake_bench_draw(struct kunit *test)
+{
+	const u16 *length = test->param_value;
+	struct snake_test *ctx = test->priv;
+	struct snake_game *game = &ctx->oled.game;
+	ktime_t start;
+	s64 ns = 0;
+	u32 bytes;
+	int i;
+	snake_bench_setup(test, *length);
+	bytes = ctx->panel.bytes;
+	for (i = 0; i < SNAKE_BENCH_ITERATIONS; i++)
+	{
+		snake_bench_turn(game);
+		snake_game_logic(game);
+		start = ktime_get();
+		snake_game_draw(&ctx->oled);
+		ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+	}
+	KUNIT_EXPECT_GT(test, ctx->panel.bytes, bytes);
+	KUNIT_EXPECT_FALSE(test, game->gameover);
+	kunit_info(test, "length %u: %lld ns/draw, %u bytes/draw\n", *length,
+			   div_s64(ns, SNAKE_BENCH_ITERATIONS), (ctx->panel.bytes - bytes) / SNAKE_BENCH_ITERATIONS);
+}
+
+static struct kunit_case snake_test_cases[] = {
+	KUNIT_CASE(embedded_to_buffer_test),
+	KUNIT_CASE(ssd1306_init_test),
+	KUNIT_CASE(ssd1306_tick_schedule_test),
+	KUNIT_CASE(snake_game_draw_test),
+	KUNIT_CASE(snake_game_logic_move_test),
+	KUNIT_CASE(add_new_element_test),
+	KUNIT_CASE(snake_growth_test),
+	KUNIT_CASE(snake_wall_collision_test),
+	KUNIT_CASE(snake_input_queue_test),
+	KUNIT_CASE(snake_frame_pacing_test),
+	KUNIT_CASE(snake_off_world_test),
+	KUNIT_CASE(snake_self_collision_test),
+	KUNIT_CASE(snake_length_cap_test),
+	KUNIT_CASE(snake_food_test),
+	KUNIT_CASE(snake_food_hint_test),
+	KUNIT_CASE(snake_scroll_test),
+	KUNIT_CASE(snake_sync_retry_test),
+	KUNIT_CASE_PARAM(snake_bench_tick, snake_bench_gen_params),
+	KUNIT_CASE_PARAM(snake_bench_draw, snake_bench_gen_params),
+	{}};
+
+static struct kunit_suite snake_test_suite = {
+	.name = "ssd1306_snake",
+	.init = snake_test_init,
+	.exit = snake_test_exit,
+	.test_cases = snake_test_cases,
+};
+kunit_test_suite(snake_test_suite);